@@ -0,0 +1,257 @@
+#pragma once
+
+// Общий периодический отчет для userspace загрузчиков XDP программ.
+//
+// Секции загрузчика (add_section) выводятся всегда. С XDP_PROFILE=1 к ним
+// добавляются:
+//  - run_time_ns / run_cnt каждой зарегистрированной BPF программы (ns/packet),
+//  - метрики цикла: пустые опросы, гистограмму размеров пачек, такты на пачку,
+//  - счетчики XDP_STATISTICS AF_XDP сокета (потери в кольцах).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+#include <bpf/bpf.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+static inline bool xdp_profile_enabled() {
+    const char *value = getenv("XDP_PROFILE");
+    return value && strcmp(value, "0") != 0;
+}
+
+// Счетчик тактов процессора (на не-x86 - наносекунды CLOCK_MONOTONIC)
+static inline uint64_t xdp_profile_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+class XdpProfiler {
+public:
+    explicit XdpProfiler(uint64_t interval_ms = 1000)
+        : interval_ns_(interval_ms * 1000000ULL),
+          next_report_ns_(now_ns() + interval_ns_) {}
+
+    ~XdpProfiler() {
+        if (stats_fd_ >= 0)
+            close(stats_fd_);
+    }
+
+    XdpProfiler(const XdpProfiler &) = delete;
+    XdpProfiler &operator=(const XdpProfiler &) = delete;
+
+    // Включает сбор run_time_ns/run_cnt в ядре, пока жив объект.
+    // Возвращает false, если профилирование не запрошено.
+    bool start() {
+        active_ = xdp_profile_enabled();
+        if (!active_)
+            return false;
+
+        stats_fd_ = bpf_enable_stats(BPF_STATS_RUN_TIME);
+        if (stats_fd_ < 0) {
+            fprintf(stderr, "[PROFILE] bpf_enable_stats failed (%d), "
+                            "try: sysctl -w kernel.bpf_stats_enabled=1\n", stats_fd_);
+        }
+        next_report_ns_ = now_ns() + interval_ns_;
+        printf("[PROFILE] enabled, report every %llu ms\n",
+               (unsigned long long)(interval_ns_ / 1000000ULL));
+        return true;
+    }
+
+    bool active() const { return active_; }
+
+    // Собственный вывод загрузчика в том же отчете (гистограммы, оценки и т.д.)
+    void add_section(std::function<void()> section) {
+        sections_.push_back(std::move(section));
+    }
+
+    void add_program(const char *name, int prog_fd) {
+        if (!active_ || prog_fd < 0)
+            return;
+        ProgStats prog;
+        prog.name = name;
+        prog.fd = prog_fd;
+        read_prog_info(prog.fd, prog.run_time_ns, prog.run_cnt);
+        progs_.push_back(prog);
+    }
+
+    void set_xsk_fd(int xsk_fd) {
+        if (!active_)
+            return;
+        xsk_fd_ = xsk_fd;
+        read_xsk_stats(prev_xsk_);
+    }
+
+    // Один опрос кольца: n == 0 - пустой опрос
+    void record_batch(uint32_t n, uint64_t cycles) {
+        if (!active_)
+            return;
+        polls_++;
+        if (n == 0) {
+            empty_polls_++;
+            return;
+        }
+        batches_++;
+        packets_ += n;
+        batch_cycles_ += cycles;
+        batch_hist_[batch_bucket(n)]++;
+    }
+
+    void maybe_report() {
+        if (!active_ && sections_.empty())
+            return;
+        uint64_t now = now_ns();
+        if (now < next_report_ns_)
+            return;
+        report();
+        next_report_ns_ = now + interval_ns_;
+    }
+
+    // Ждет Enter, выводя отчеты в процессе (для загрузчиков без своего цикла)
+    void wait_enter() {
+        if (!active_ && sections_.empty()) {
+            getchar();
+            return;
+        }
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        while (poll(&pfd, 1, 100) == 0)
+            maybe_report();
+        getchar();
+    }
+
+    void report() {
+        for (auto &section : sections_)
+            section();
+        if (!active_)
+            return;
+
+        for (auto &prog : progs_) {
+            uint64_t run_time_ns = 0, run_cnt = 0;
+            if (!read_prog_info(prog.fd, run_time_ns, run_cnt))
+                continue;
+            uint64_t d_time = run_time_ns - prog.run_time_ns;
+            uint64_t d_cnt = run_cnt - prog.run_cnt;
+            printf("[PROFILE] prog %s: run_cnt=%llu run_time_ns=%llu ns/pkt=%.1f\n",
+                   prog.name.c_str(),
+                   (unsigned long long)d_cnt,
+                   (unsigned long long)d_time,
+                   d_cnt ? (double)d_time / (double)d_cnt : 0.0);
+            prog.run_time_ns = run_time_ns;
+            prog.run_cnt = run_cnt;
+        }
+
+        if (polls_) {
+            printf("[PROFILE] loop: polls=%llu empty=%llu (%.1f%%) batches=%llu pkts=%llu "
+                   "avg_batch=%.1f cycles/batch=%.0f cycles/pkt=%.0f\n",
+                   (unsigned long long)polls_,
+                   (unsigned long long)empty_polls_,
+                   100.0 * (double)empty_polls_ / (double)polls_,
+                   (unsigned long long)batches_,
+                   (unsigned long long)packets_,
+                   batches_ ? (double)packets_ / (double)batches_ : 0.0,
+                   batches_ ? (double)batch_cycles_ / (double)batches_ : 0.0,
+                   packets_ ? (double)batch_cycles_ / (double)packets_ : 0.0);
+            printf("[PROFILE] batch sizes:");
+            for (int i = 0; i < BATCH_BUCKETS; i++) {
+                if (i == BATCH_BUCKETS - 1)
+                    printf(" %u+:%llu", 1U << i, (unsigned long long)batch_hist_[i]);
+                else
+                    printf(" %u-%u:%llu", 1U << i, (2U << i) - 1,
+                           (unsigned long long)batch_hist_[i]);
+            }
+            printf("\n");
+        }
+
+        struct xdp_statistics xsk;
+        if (xsk_fd_ >= 0 && read_xsk_stats(xsk)) {
+            printf("[PROFILE] xsk: rx_dropped=%llu rx_invalid_descs=%llu rx_ring_full=%llu "
+                   "fill_ring_empty=%llu tx_invalid_descs=%llu tx_ring_empty=%llu\n",
+                   (unsigned long long)(xsk.rx_dropped - prev_xsk_.rx_dropped),
+                   (unsigned long long)(xsk.rx_invalid_descs - prev_xsk_.rx_invalid_descs),
+                   (unsigned long long)(xsk.rx_ring_full - prev_xsk_.rx_ring_full),
+                   (unsigned long long)(xsk.rx_fill_ring_empty_descs -
+                                        prev_xsk_.rx_fill_ring_empty_descs),
+                   (unsigned long long)(xsk.tx_invalid_descs - prev_xsk_.tx_invalid_descs),
+                   (unsigned long long)(xsk.tx_ring_empty_descs - prev_xsk_.tx_ring_empty_descs));
+            prev_xsk_ = xsk;
+        }
+
+        polls_ = empty_polls_ = batches_ = packets_ = batch_cycles_ = 0;
+        memset(batch_hist_, 0, sizeof(batch_hist_));
+    }
+
+private:
+    // Корзины размеров пачек: 1, 2-3, 4-7, ..., 128+
+    static constexpr int BATCH_BUCKETS = 8;
+
+    struct ProgStats {
+        std::string name;
+        int fd = -1;
+        uint64_t run_time_ns = 0;
+        uint64_t run_cnt = 0;
+    };
+
+    static int batch_bucket(uint32_t n) {
+        int bucket = 31 - __builtin_clz(n);
+        return bucket < BATCH_BUCKETS ? bucket : BATCH_BUCKETS - 1;
+    }
+
+    static uint64_t now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    }
+
+    static bool read_prog_info(int prog_fd, uint64_t &run_time_ns, uint64_t &run_cnt) {
+        struct bpf_prog_info info;
+        __u32 len = sizeof(info);
+        memset(&info, 0, sizeof(info));
+        if (bpf_obj_get_info_by_fd(prog_fd, &info, &len) != 0)
+            return false;
+        run_time_ns = info.run_time_ns;
+        run_cnt = info.run_cnt;
+        return true;
+    }
+
+    bool read_xsk_stats(struct xdp_statistics &stats) const {
+        socklen_t len = sizeof(stats);
+        memset(&stats, 0, sizeof(stats));
+        return getsockopt(xsk_fd_, SOL_XDP, XDP_STATISTICS, &stats, &len) == 0;
+    }
+
+    bool active_ = false;
+    int stats_fd_ = -1;
+    int xsk_fd_ = -1;
+    uint64_t interval_ns_;
+    uint64_t next_report_ns_ = 0;
+    std::vector<ProgStats> progs_;
+    std::vector<std::function<void()>> sections_;
+    struct xdp_statistics prev_xsk_ = {};
+
+    uint64_t polls_ = 0;
+    uint64_t empty_polls_ = 0;
+    uint64_t batches_ = 0;
+    uint64_t packets_ = 0;
+    uint64_t batch_cycles_ = 0;
+    uint64_t batch_hist_[BATCH_BUCKETS] = {};
+};
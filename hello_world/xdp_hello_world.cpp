@@ -4,6 +4,8 @@
 #include <net/if.h>
 #include <linux/if_link.h>
 
+#include "xdp_profile.h"
+
 int main(int argc, char **argv) {
     if (argc < 4) {
         printf("Usage: %s <ifname> <xdp-obj-path> <xdp-app-name>\n", argv[0]);
@@ -53,8 +55,13 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // Профилирование (XDP_PROFILE=1): run_time_ns/run_cnt программы
+    XdpProfiler profiler;
+    if (profiler.start())
+        profiler.add_program(xdp_app_name, prog_fd);
+
     printf("XDP program attached to %s. Press Enter to detach...\n", ifname);
-    getchar();
+    profiler.wait_enter();
 
     // 6. Отсоединяем программу
     bpf_set_link_xdp_fd(ifindex, -1, flags);
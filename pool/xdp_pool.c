@@ -20,11 +20,39 @@
     if ((void *)(ptr) + (size) > data_end) \
         return XDP_PASS;
 
+#define SAMPLE_HEADER_SIZE 128
+
 struct {
     __uint(type, BPF_MAP_TYPE_RINGBUF);
     __uint(max_entries, 256 * 1024); // 256 KB
 } ringbuf SEC(".maps");
 
+// Sampling config, written from userspace (1 or 0 = every packet)
+struct sample_config {
+    __u32 sample_rate;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, struct sample_config);
+    __uint(max_entries, 1);
+} sample_config SEC(".maps");
+
+// Per-CPU counters: all IPv4 packets seen and how many of them were sampled
+struct sample_stats {
+    __u64 packets;
+    __u64 sampled;
+    __u64 dropped; // sampled, but ring buffer was full
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __type(key, __u32);
+    __type(value, struct sample_stats);
+    __uint(max_entries, 1);
+} sample_stats SEC(".maps");
+
 struct event {
     __u8 protocol;
     __u32 packet_size;
@@ -32,6 +60,9 @@ struct event {
     __u32 daddr;
     __u16 sport;
     __u16 dport;
+    __u32 sample_rate; // rate in effect when the packet was sampled
+    __u32 header_len;  // valid bytes in header[]
+    __u8 header[SAMPLE_HEADER_SIZE];
 };
 
 SEC("xdp")
@@ -55,27 +86,65 @@ int xdp_parser(struct xdp_md *ctx) {
     if (ip->version != 4 || ip->ihl < 5)
         return XDP_PASS;
 
-    struct event e = {};
-    e.protocol = ip->protocol;
-    e.packet_size = bpf_ntohs(ip->tot_len);
-    e.saddr = ip->saddr;
-    e.daddr = ip->daddr;
+    __u32 key = 0;
+    struct sample_stats *stats = bpf_map_lookup_elem(&sample_stats, &key);
+    if (!stats)
+        return XDP_PASS;
+    stats->packets++;
+
+    // 1-in-N random sampling, the rest of the packets only bump the counter
+    __u32 rate = 1;
+    struct sample_config *cfg = bpf_map_lookup_elem(&sample_config, &key);
+    if (cfg && cfg->sample_rate > 1)
+        rate = cfg->sample_rate;
+    if (rate > 1 && bpf_get_prandom_u32() % rate != 0)
+        return XDP_PASS;
+    stats->sampled++;
+
+    struct event *e = bpf_ringbuf_reserve(&ringbuf, sizeof(*e), 0);
+    if (!e) {
+        stats->dropped++;
+        return XDP_PASS;
+    }
+    e->protocol = ip->protocol;
+    e->packet_size = bpf_ntohs(ip->tot_len);
+    e->saddr = ip->saddr;
+    e->daddr = ip->daddr;
+    e->sport = 0;
+    e->dport = 0;
+    e->sample_rate = rate;
+
+    // Snapshot of the first SAMPLE_HEADER_SIZE bytes of the frame. Plain
+    // direct packet access (unrolled, so every offset is a constant) instead
+    // of bpf_xdp_load_bytes(), which needs kernel 5.18+
+    __u32 header_len = 0;
+#pragma unroll
+    for (int i = 0; i < SAMPLE_HEADER_SIZE; i++) {
+        __u8 *byte = data + i;
+        if ((void *)(byte + 1) > data_end)
+            break;
+        e->header[i] = *byte;
+        header_len++;
+    }
+    e->header_len = header_len;
 
     // Parse Transport
     switch (ip->protocol) {
         case IPPROTO_TCP: {
             struct tcphdr *tcp = data + sizeof(*eth) + (ip->ihl * 4);
-            CHECK_BOUNDS(tcp, sizeof(*tcp))
-            e.sport = bpf_ntohs(tcp->source);
-            e.dport = bpf_ntohs(tcp->dest);
+            if ((void *)(tcp + 1) > data_end)
+                break;
+            e->sport = bpf_ntohs(tcp->source);
+            e->dport = bpf_ntohs(tcp->dest);
             bpf_printk("[TCP] package\n");
             break;
         }
         case IPPROTO_UDP: {
             struct udphdr *udp = data + sizeof(*eth) + (ip->ihl * 4);
-            CHECK_BOUNDS(udp, sizeof(*udp))
-            e.sport = bpf_ntohs(udp->source);
-            e.dport = bpf_ntohs(udp->dest);
+            if ((void *)(udp + 1) > data_end)
+                break;
+            e->sport = bpf_ntohs(udp->source);
+            e->dport = bpf_ntohs(udp->dest);
             bpf_printk("[UDP] package\n");   
             break;
         }
@@ -86,7 +155,7 @@ int xdp_parser(struct xdp_md *ctx) {
     }
 
     // Send event into ring buffer
-    bpf_ringbuf_output(&ringbuf, &e, sizeof(e), 0);
+    bpf_ringbuf_submit(e, 0);
     return XDP_PASS;
 }
 
@@ -15,6 +15,11 @@
 #include <thread>
 #include <atomic>
 #include <csignal>
+#include <cerrno>
+#include <vector>
+#include <poll.h>
+
+#include "xdp_profile.h"
 #include <unistd.h>
 #include <net/if.h>
 #include <linux/if_link.h>
@@ -23,6 +28,9 @@
 
 std::atomic<bool> running{true};
 
+#define SAMPLE_HEADER_SIZE 128
+#define HEADER_DUMP_SIZE   64   // Сколько байт снимка выводить в hex
+
 // Структура события (должна совпадать с eBPF-программой)
 struct event {
     __u8 protocol;
@@ -31,6 +39,27 @@ struct event {
     __u32 daddr;
     __u16 sport;
     __u16 dport;
+    __u32 sample_rate;
+    __u32 header_len;
+    __u8 header[SAMPLE_HEADER_SIZE];
+};
+
+// Конфигурация и счетчики сэмплирования (должны совпадать с eBPF-программой)
+struct sample_config {
+    __u32 sample_rate;
+};
+
+struct sample_stats {
+    __u64 packets;
+    __u64 sampled;
+    __u64 dropped;
+};
+
+// Оценка полного трафика по сэмплам: каждый сэмпл "весит" sample_rate пакетов
+struct traffic_estimate {
+    __u64 samples[256];
+    __u64 packets[256];
+    __u64 bytes[256];
 };
 
 // Обработчик сигналов (Ctrl+C)
@@ -41,21 +70,92 @@ void signal_handler(int) {
 // Callback для ring buffer
 static int handle_event(void *ctx, void *data, size_t size) {
     const auto *e = static_cast<event*>(data);
-    printf("Packet: proto=%u, size=%u, %u.%u.%u.%u:%u -> %u.%u.%u.%u:%u\n",
+    auto *est = static_cast<traffic_estimate*>(ctx);
+    est->samples[e->protocol]++;
+    est->packets[e->protocol] += e->sample_rate;
+    est->bytes[e->protocol] += (__u64)e->sample_rate * e->packet_size;
+
+    printf("Packet: proto=%u, size=%u, rate=1/%u, hdr=%uB, %u.%u.%u.%u:%u -> %u.%u.%u.%u:%u\n",
            e->protocol,
            e->packet_size,
+           e->sample_rate,
+           e->header_len,
            (e->saddr >> 24) & 0xFF, (e->saddr >> 16) & 0xFF,
            (e->saddr >> 8) & 0xFF, e->saddr & 0xFF,
            e->sport,
            (e->daddr >> 24) & 0xFF, (e->daddr >> 16) & 0xFF,
            (e->daddr >> 8) & 0xFF, e->daddr & 0xFF,
            e->dport);
+
+    // Снимок заголовков: первые байты кадра в hex (Ethernet + IP + L4)
+    __u32 header_len = e->header_len < SAMPLE_HEADER_SIZE ? e->header_len : SAMPLE_HEADER_SIZE;
+    for (__u32 off = 0; off < header_len && off < HEADER_DUMP_SIZE; off += 16) {
+        printf("  %04x: ", off);
+        for (__u32 j = off; j < off + 16 && j < header_len && j < HEADER_DUMP_SIZE; j++)
+            printf("%02x ", e->header[j]);
+        printf("\n");
+    }
+    if (header_len > HEADER_DUMP_SIZE)
+        printf("  ... (%u bytes captured)\n", header_len);
     return 0;
 }
 
+// Суммирует per-CPU счетчики сэмплирования
+static bool read_sample_stats(int map_fd, sample_stats &total) {
+    static const int ncpus = libbpf_num_possible_cpus();
+    std::vector<sample_stats> values(ncpus > 0 ? ncpus : 1);
+    __u32 key = 0;
+    if (bpf_map_lookup_elem(map_fd, &key, values.data()) != 0)
+        return false;
+
+    total = {};
+    for (const auto &v : values) {
+        total.packets += v.packets;
+        total.sampled += v.sampled;
+        total.dropped += v.dropped;
+    }
+    return true;
+}
+
+// Периодический отчет: оценка по сэмплам против точного счетчика в ядре.
+// Сэмплы, потерянные при переполнении ring buffer, до userspace не доходят,
+// поэтому оценка домножается на sampled / (sampled - dropped).
+static void print_estimate(const traffic_estimate &est, int stats_fd) {
+    sample_stats stats = {};
+    bool have_stats = read_sample_stats(stats_fd, stats);
+    double drop_scale = 1.0;
+    if (have_stats && stats.sampled > stats.dropped)
+        drop_scale = (double)stats.sampled / (double)(stats.sampled - stats.dropped);
+
+    __u64 est_packets = 0;
+    printf("--- Sampled traffic estimate ---\n");
+    for (int proto = 0; proto < 256; proto++) {
+        if (!est.samples[proto])
+            continue;
+        __u64 packets = (__u64)((double)est.packets[proto] * drop_scale);
+        __u64 bytes = (__u64)((double)est.bytes[proto] * drop_scale);
+        est_packets += packets;
+        printf("  proto=%3d samples=%llu est_packets=%llu est_bytes=%llu\n",
+               proto,
+               (unsigned long long)est.samples[proto],
+               (unsigned long long)packets,
+               (unsigned long long)bytes);
+    }
+
+    if (have_stats) {
+        printf("  total: est_packets=%llu seen=%llu sampled=%llu ringbuf_drops=%llu "
+               "drop_correction=x%.3f\n",
+               (unsigned long long)est_packets,
+               (unsigned long long)stats.packets,
+               (unsigned long long)stats.sampled,
+               (unsigned long long)stats.dropped,
+               drop_scale);
+    }
+}
+
 int main(int argc, char **argv) {
     if (argc < 3) {
-        printf("Usage: %s <ifname> <xdp-obj-path>\n", argv[0]);
+        printf("Usage: %s <ifname> <xdp-obj-path> [sample-rate]\n", argv[0]);
         return 1;
     }
 
@@ -63,7 +163,16 @@ int main(int argc, char **argv) {
     const char *xdp_obj_path = argv[2];
     struct bpf_object *obj = nullptr;
     struct ring_buffer *rb = nullptr;
-    int ifindex, prog_fd, map_fd;
+    int ifindex, prog_fd, map_fd, config_fd, stats_fd;
+    __u32 config_key = 0;
+    sample_config config = {};
+    traffic_estimate estimate = {};
+    XdpProfiler profiler;
+
+    // 1 - каждый пакет, N - в среднем один из N пакетов
+    config.sample_rate = argc > 3 ? (__u32)strtoul(argv[3], nullptr, 10) : 1;
+    if (config.sample_rate == 0)
+        config.sample_rate = 1;
 
     // 1. Настройка обработчика сигналов
     signal(SIGINT, signal_handler);
@@ -89,7 +198,20 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
-    // 5. Прикрепляем XDP-программу
+    // 5. Задаем частоту сэмплирования до подключения программы
+    config_fd = bpf_object__find_map_fd_by_name(obj, "sample_config");
+    stats_fd = bpf_object__find_map_fd_by_name(obj, "sample_stats");
+    if (config_fd < 0 || stats_fd < 0) {
+        fprintf(stderr, "Failed to find sampling maps\n");
+        goto cleanup;
+    }
+
+    if (bpf_map_update_elem(config_fd, &config_key, &config, BPF_ANY)) {
+        fprintf(stderr, "Failed to set sample rate\n");
+        goto cleanup;
+    }
+
+    // 6. Прикрепляем XDP-программу
     prog_fd = bpf_program__fd(bpf_object__find_program_by_name(obj, "xdp_parser"));
     if (prog_fd < 0) {
         fprintf(stderr, "Failed to find XDP program\n");
@@ -101,31 +223,55 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
-    // 6. Настраиваем ring buffer
+    // 7. Настраиваем ring buffer
     map_fd = bpf_object__find_map_fd_by_name(obj, "ringbuf");
     if (map_fd < 0) {
         fprintf(stderr, "Failed to find ringbuf map\n");
         goto detach;
     }
 
-    rb = ring_buffer__new(map_fd, handle_event, nullptr, nullptr);
+    rb = ring_buffer__new(map_fd, handle_event, &estimate, nullptr);
     if (!rb) {
         fprintf(stderr, "Failed to create ring buffer\n");
         goto detach;
     }
 
-    printf("Monitoring XDP events on interface %s. Press Ctrl+C to stop.\n", ifname);
+    // Раз в секунду выводим оценку полного трафика (в общем отчете профилировщика)
+    profiler.add_section([&]() { print_estimate(estimate, stats_fd); });
 
-    // 7. Основной цикл чтения событий
+    // Профилирование (XDP_PROFILE=1): время программы и метрики цикла опроса
+    if (profiler.start())
+        profiler.add_program("xdp_parser", prog_fd);
+
+    printf("Monitoring XDP events on interface %s (sample rate 1/%u). Press Ctrl+C to stop.\n",
+           ifname, config.sample_rate);
+
+    // 8. Основной цикл чтения событий
+    // Ожидание (poll) и разбор событий (consume) разделены, чтобы такты
+    // на пачку не включали время сна
     while (running) {
-        int err = ring_buffer__poll(rb, 100 /* timeout (ms) */);
-        if (err < 0 && err != -EINTR) {
-            fprintf(stderr, "Error polling ring buffer: %d\n", err);
+        struct pollfd pfd = {ring_buffer__epoll_fd(rb), POLLIN, 0};
+        int ready = poll(&pfd, 1, 100 /* timeout (ms) */);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
             break;
         }
+
+        if (ready > 0) {
+            uint64_t start = xdp_profile_cycles();
+            int consumed = ring_buffer__consume(rb);
+            if (consumed < 0) {
+                fprintf(stderr, "Error consuming ring buffer: %d\n", consumed);
+                break;
+            }
+            profiler.record_batch(consumed, xdp_profile_cycles() - start);
+        } else {
+            profiler.record_batch(0, 0);
+        }
+        profiler.maybe_report();
     }
 
-    // 8. Очистка
+    // 9. Очистка
 detach:
     bpf_set_link_xdp_fd(ifindex, -1, XDP_FLAGS_UPDATE_IF_NOEXIST);
 cleanup:
@@ -18,6 +18,98 @@ struct {
     __uint(max_entries, 1024);
 } packet_stat SEC(".maps");
 
+// Count-min sketch for heavy-hitter detection (xdp_heavy_hitters).
+// Must match definitions in xdp_stat.cpp.
+#define CMS_DEPTH       4
+#define CMS_WIDTH_BITS  12
+#define CMS_WIDTH       (1 << CMS_WIDTH_BITS)
+#define CMS_CAND_SLOTS  256
+
+#define CMS_DIR_SRC 0
+#define CMS_DIR_DST 1
+#define CMS_DIRS    2
+
+// Two sketch generations: the program writes the active one, userspace
+// flips cms_config and then reads and clears the idle one, so no packets
+// are lost between reading and resetting an interval
+#define CMS_GENS    2
+
+// Active generation (0 or 1), written from userspace
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(max_entries, 1);
+} cms_config SEC(".maps");
+
+// One sketch row, key = (gen * CMS_DIRS + dir) * CMS_DEPTH + row
+struct cms_row {
+    __u32 counts[CMS_WIDTH];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __type(key, __u32);
+    __type(value, struct cms_row);
+    __uint(max_entries, CMS_GENS * CMS_DIRS * CMS_DEPTH);
+} cms_sketch SEC(".maps");
+
+// Fixed-size candidate table, key = gen * CMS_DIRS + dir. Userspace can't
+// enumerate keys of the sketch, so the heaviest address seen per slot is
+// remembered here.
+struct cms_candidates {
+    __u32 addr[CMS_CAND_SLOTS];
+    __u32 estimate[CMS_CAND_SLOTS];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __type(key, __u32);
+    __type(value, struct cms_candidates);
+    __uint(max_entries, CMS_GENS * CMS_DIRS);
+} cms_candidates SEC(".maps");
+
+// Multiply-add-shift hash seeds, one pair per sketch row
+static const __u64 cms_seed_a[CMS_DEPTH] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+    0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL,
+};
+static const __u64 cms_seed_b[CMS_DEPTH] = {
+    0x85ebca77c2b2ae63ULL, 0x27d4eb2f165667c5ULL,
+    0xff51afd7ed558ccdULL, 0xc4ceb9fe1a85ec53ULL,
+};
+
+static __always_inline __u32 cms_hash(__u32 row, __u32 addr) {
+    return (__u32)((cms_seed_a[row] * addr + cms_seed_b[row]) >> (64 - CMS_WIDTH_BITS));
+}
+
+static __always_inline void cms_add(__u32 gen, __u32 dir, __u32 addr) {
+    __u32 estimate = 0xffffffff;
+
+#pragma unroll
+    for (__u32 row = 0; row < CMS_DEPTH; row++) {
+        __u32 key = (gen * CMS_DIRS + dir) * CMS_DEPTH + row;
+        struct cms_row *r = bpf_map_lookup_elem(&cms_sketch, &key);
+        if (!r)
+            return;
+        __u32 col = cms_hash(row, addr) & (CMS_WIDTH - 1);
+        __u32 count = ++r->counts[col];
+        if (count < estimate)
+            estimate = count;
+    }
+
+    // Keep the heavier address in its candidate slot
+    __u32 cand_key = gen * CMS_DIRS + dir;
+    struct cms_candidates *cand = bpf_map_lookup_elem(&cms_candidates, &cand_key);
+    if (!cand)
+        return;
+    __u32 slot = cms_hash(0, addr) & (CMS_CAND_SLOTS - 1);
+    if (cand->addr[slot] == addr || estimate > cand->estimate[slot]) {
+        cand->addr[slot] = addr;
+        cand->estimate[slot] = estimate;
+    }
+}
+
 SEC("xdp")
 int xdp_parser(struct xdp_md *ctx) {
     void *data = (void *)(long)ctx->data;
@@ -53,4 +145,36 @@ int xdp_parser(struct xdp_md *ctx) {
     return XDP_PASS;
 }
 
+SEC("xdp")
+int xdp_heavy_hitters(struct xdp_md *ctx) {
+    void *data = (void *)(long)ctx->data;
+    void *data_end = (void *)(long)ctx->data_end;
+
+    // Parse Ethernet-header
+    struct ethhdr *eth = (struct ethhdr*)data;
+    CHECK_BOUNDS(eth, sizeof(*eth));
+
+    // Pass non-IP packets
+    if (eth->h_proto != bpf_htons(ETH_P_IP))
+        return XDP_PASS;
+
+    // Parser IP-header
+    struct iphdr *ip = data + sizeof(*eth);
+    CHECK_BOUNDS(ip, sizeof(*ip))
+
+    // Only IPv4
+    if (ip->version != 4 || ip->ihl < 5)
+        return XDP_PASS;
+
+    // Select the generation userspace is not reading
+    __u32 key = 0;
+    __u32 *active = bpf_map_lookup_elem(&cms_config, &key);
+    __u32 gen = active ? (*active & 1) : 0;
+
+    // Update per-CPU sketches, memory stays constant whatever the traffic
+    cms_add(gen, CMS_DIR_SRC, ip->saddr);
+    cms_add(gen, CMS_DIR_DST, ip->daddr);
+    return XDP_PASS;
+}
+
 char _license[] SEC("license") = "GPL";
\ No newline at end of file
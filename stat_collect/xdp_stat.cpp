@@ -5,12 +5,219 @@
 #include <linux/if_link.h>
 #include <linux/types.h>
 
+#include <arpa/inet.h>
+
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+#include "xdp_profile.h"
+
+// Параметры count-min sketch (должны совпадать с eBPF-программой)
+#define CMS_DEPTH       4
+#define CMS_WIDTH_BITS  12
+#define CMS_WIDTH       (1 << CMS_WIDTH_BITS)
+#define CMS_CAND_SLOTS  256
+
+#define CMS_DIR_SRC 0
+#define CMS_DIR_DST 1
+#define CMS_DIRS    2
+#define CMS_GENS    2
+
+#define TOP_K 10
+#define REPORT_INTERVAL_SEC 1
+
+struct cms_row {
+    __u32 counts[CMS_WIDTH];
+};
+
+struct cms_candidates {
+    __u32 addr[CMS_CAND_SLOTS];
+    __u32 estimate[CMS_CAND_SLOTS];
+};
+
+static const __u64 cms_seed_a[CMS_DEPTH] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+    0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL,
+};
+static const __u64 cms_seed_b[CMS_DEPTH] = {
+    0x85ebca77c2b2ae63ULL, 0x27d4eb2f165667c5ULL,
+    0xff51afd7ed558ccdULL, 0xc4ceb9fe1a85ec53ULL,
+};
+
+struct talker {
+    __u32 addr;
+    __u64 estimate;
+};
+
+static std::atomic<bool> running{true};
+
+// Обработчик сигналов (Ctrl+C)
+static void signal_handler(int) {
+    running = false;
+}
+
+static __u32 cms_hash(__u32 row, __u32 addr) {
+    return (__u32)((cms_seed_a[row] * addr + cms_seed_b[row]) >> (64 - CMS_WIDTH_BITS));
+}
+
+// Ключи карт для поколения gen (см. cms_sketch/cms_candidates в eBPF-программе)
+static __u32 sketch_key(__u32 gen, __u32 dir, __u32 row) {
+    return (gen * CMS_DIRS + dir) * CMS_DEPTH + row;
+}
+
+static __u32 candidates_key(__u32 gen, __u32 dir) {
+    return gen * CMS_DIRS + dir;
+}
+
+// Складывает per-CPU строки скетча одного направления в merged[row * CMS_WIDTH + col]
+static bool merge_sketch(int sketch_fd, __u32 gen, __u32 dir, int ncpus,
+                         std::vector<__u64> &merged) {
+    std::vector<cms_row> rows(ncpus);
+    merged.assign(CMS_DEPTH * CMS_WIDTH, 0);
+    for (__u32 row = 0; row < CMS_DEPTH; row++) {
+        __u32 key = sketch_key(gen, dir, row);
+        if (bpf_map_lookup_elem(sketch_fd, &key, rows.data()) != 0)
+            return false;
+        for (int cpu = 0; cpu < ncpus; cpu++)
+            for (__u32 col = 0; col < CMS_WIDTH; col++)
+                merged[row * CMS_WIDTH + col] += rows[cpu].counts[col];
+    }
+    return true;
+}
+
+static __u64 cms_estimate(const std::vector<__u64> &merged, __u32 addr) {
+    __u64 estimate = UINT64_MAX;
+    for (__u32 row = 0; row < CMS_DEPTH; row++) {
+        __u64 count = merged[row * CMS_WIDTH + (cms_hash(row, addr) & (CMS_WIDTH - 1))];
+        estimate = std::min(estimate, count);
+    }
+    return estimate;
+}
+
+// Кандидаты из всех CPU, реальные оценки берутся из объединенного скетча
+static bool collect_candidates(int cand_fd, __u32 gen, __u32 dir, int ncpus,
+                               std::unordered_set<__u32> &out) {
+    std::vector<cms_candidates> cand(ncpus);
+    __u32 key = candidates_key(gen, dir);
+    if (bpf_map_lookup_elem(cand_fd, &key, cand.data()) != 0)
+        return false;
+    for (int cpu = 0; cpu < ncpus; cpu++)
+        for (__u32 slot = 0; slot < CMS_CAND_SLOTS; slot++)
+            if (cand[cpu].estimate[slot])
+                out.insert(cand[cpu].addr[slot]);
+    return true;
+}
+
+// Обнуляем неактивное поколение, чтобы следующий его интервал считался заново
+static void reset_sketch(int sketch_fd, int cand_fd, __u32 gen, int ncpus) {
+    std::vector<cms_row> zero_rows(ncpus);
+    std::vector<cms_candidates> zero_cand(ncpus);
+    memset(zero_rows.data(), 0, zero_rows.size() * sizeof(cms_row));
+    memset(zero_cand.data(), 0, zero_cand.size() * sizeof(cms_candidates));
+    for (__u32 dir = 0; dir < CMS_DIRS; dir++) {
+        for (__u32 row = 0; row < CMS_DEPTH; row++) {
+            __u32 key = sketch_key(gen, dir, row);
+            bpf_map_update_elem(sketch_fd, &key, zero_rows.data(), BPF_ANY);
+        }
+        __u32 key = candidates_key(gen, dir);
+        bpf_map_update_elem(cand_fd, &key, zero_cand.data(), BPF_ANY);
+    }
+}
+
+static void print_top_talkers(const char *title, std::vector<talker> &talkers) {
+    size_t k = std::min<size_t>(TOP_K, talkers.size());
+    std::partial_sort(talkers.begin(), talkers.begin() + k, talkers.end(),
+                      [](const talker &a, const talker &b) { return a.estimate > b.estimate; });
+
+    printf("Top %zu %s:\n", k, title);
+    for (size_t i = 0; i < k; i++) {
+        char buf[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &talkers[i].addr, buf, sizeof(buf));
+        printf("  %2zu. %-15s %llu packets\n", i + 1, buf,
+               (unsigned long long)talkers[i].estimate);
+    }
+}
+
+// Режим поиска "тяжелых" адресов: раз в интервал переключаем поколение
+// скетча, объединяем per-CPU скетчи бывшего активного поколения, оцениваем
+// кандидатов и выводим top-K источников и получателей
+static int run_heavy_hitters(struct bpf_object *obj, XdpProfiler &profiler) {
+    int sketch_fd = bpf_object__find_map_fd_by_name(obj, "cms_sketch");
+    int cand_fd = bpf_object__find_map_fd_by_name(obj, "cms_candidates");
+    int config_fd = bpf_object__find_map_fd_by_name(obj, "cms_config");
+    if (sketch_fd < 0 || cand_fd < 0 || config_fd < 0) {
+        fprintf(stderr, "Failed to find count-min sketch maps\n");
+        return 1;
+    }
+
+    int ncpus = libbpf_num_possible_cpus();
+    if (ncpus <= 0) {
+        fprintf(stderr, "Failed to get number of CPUs\n");
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    printf("Collecting heavy hitters every %d s. Press Ctrl+C to stop.\n", REPORT_INTERVAL_SEC);
+
+    // Интервалы скетча отсчитывает таймер общего отчета профилировщика
+    std::vector<__u64> merged;
+    __u32 config_key = 0, active = 0;
+    bool failed = false;
+    profiler.add_section([&]() {
+        // Переключаем программу на другое поколение; уже запущенные вызовы
+        // XDP завершаются за микросекунды, пауза дает им дописать старое
+        __u32 idle = active;
+        active ^= 1;
+        if (bpf_map_update_elem(config_fd, &config_key, &active, BPF_ANY) != 0) {
+            fprintf(stderr, "Failed to switch count-min sketch generation\n");
+            failed = true;
+            running = false;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        for (__u32 dir = 0; dir < CMS_DIRS; dir++) {
+            std::unordered_set<__u32> candidates;
+            if (!merge_sketch(sketch_fd, idle, dir, ncpus, merged) ||
+                !collect_candidates(cand_fd, idle, dir, ncpus, candidates)) {
+                fprintf(stderr, "Failed to read count-min sketch\n");
+                failed = true;
+                running = false;
+                return;
+            }
+
+            std::vector<talker> talkers;
+            talkers.reserve(candidates.size());
+            for (__u32 addr : candidates)
+                talkers.push_back({addr, cms_estimate(merged, addr)});
+            print_top_talkers(dir == CMS_DIR_SRC ? "sources" : "destinations", talkers);
+        }
+        reset_sketch(sketch_fd, cand_fd, idle, ncpus);
+    });
+
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        profiler.maybe_report();
+    }
+    return failed ? 1 : 0;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s <ifname> <xdp-obj-path> [proto|hh]\n", prog);
+    printf("  proto - packet counters by IP protocol (default)\n");
+    printf("  hh    - heavy hitters via per-CPU count-min sketch\n");
+}
 
 int main(int argc, char **argv) {
     if (argc < 3) {
-        printf("Usage: %s <ifname> <xdp-obj-path>\n", argv[0]);
+        print_usage(argv[0]);
         return 1;
     }
 
@@ -18,7 +225,14 @@ int main(int argc, char **argv) {
     int prog_fd, map_fd, ifindex;
     const char *ifname = argv[1];
     const char *xdp_obj_path = argv[2];
-    const char *xdp_app_name = "xdp_parser";
+    const char *mode = argc > 3 ? argv[3] : "proto";
+    if (strcmp(mode, "proto") != 0 && strcmp(mode, "hh") != 0) {
+        fprintf(stderr, "Unknown mode '%s'\n", mode);
+        print_usage(argv[0]);
+        return 1;
+    }
+    bool heavy_hitters = strcmp(mode, "hh") == 0;
+    const char *xdp_app_name = heavy_hitters ? "xdp_heavy_hitters" : "xdp_parser";
     const char *xdp_map_name = "packet_stat";
 
     // 1. Получаем индекс интерфейса
@@ -58,6 +272,19 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // Профилирование (XDP_PROFILE=1): run_time_ns/run_cnt программы
+    XdpProfiler profiler(REPORT_INTERVAL_SEC * 1000);
+    if (profiler.start())
+        profiler.add_program(xdp_app_name, prog_fd);
+
+    // 6. Режим heavy hitters работает до Ctrl+C
+    if (heavy_hitters) {
+        int ret = run_heavy_hitters(obj, profiler);
+        bpf_set_link_xdp_fd(ifindex, -1, flags);
+        bpf_object__close(obj);
+        return ret;
+    }
+
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
     struct bpf_map *map = bpf_object__find_map_by_name(obj, xdp_map_name);
@@ -93,7 +320,7 @@ int main(int argc, char **argv) {
 
     // 9. Ожидание перед отключением
     printf("Press Enter to detach and exit...\n");
-    getchar();
+    profiler.wait_enter();
 
     // 10. Отсоединяем программу
     bpf_set_link_xdp_fd(ifindex, -1, flags);
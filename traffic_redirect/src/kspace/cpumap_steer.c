@@ -0,0 +1,211 @@
+#include <linux/bpf.h>      // Basic eBPF definitions and types
+#include <linux/if_ether.h> // Ethernet protocol definitions
+#include <linux/ip.h>       // IPv4 header
+#include <linux/ipv6.h>     // IPv6 header
+#include <linux/tcp.h>      // TCP header
+#include <linux/udp.h>      // UDP header
+#include <bpf/bpf_helpers.h> // eBPF helper functions
+#include <bpf/bpf_endian.h>  // bpf_htons()/bpf_ntohs()
+
+#ifndef IPPROTO_TCP
+#define IPPROTO_TCP 6
+#endif
+
+#ifndef IPPROTO_UDP
+#define IPPROTO_UDP 17
+#endif
+
+// IPv4 fragment bits of frag_off (host byte order, from net/ip.h)
+#define IP_MF     0x2000
+#define IP_OFFSET 0x1FFF
+
+// Capacity of cpus_available, i.e. how many target CPUs can be configured.
+// CPU ids themselves are not limited by it: cpu_map is keyed by CPU id and the
+// loader resizes it to the number of possible CPUs before loading.
+#define MAX_SLOTS 64
+
+// License declaration - mandatory for eBPF programs
+char LICENSE[] SEC("license") = "GPL";
+
+// CPUMAP: key = CPU id, value = struct bpf_cpumap_val (queue size and
+// optional second-stage program). Each entry owns a kthread on that CPU
+// which builds SKBs and runs the kernel network stack.
+struct {
+    __uint(type, BPF_MAP_TYPE_CPUMAP);
+    __uint(max_entries, MAX_SLOTS); // placeholder, resized by the loader
+    __type(key, __u32);
+    __type(value, struct bpf_cpumap_val);
+} cpu_map SEC(".maps");
+
+// Set of target CPUs: slot -> CPU id, filled by the loader
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, MAX_SLOTS);
+    __type(key, __u32);
+    __type(value, __u32);
+} cpus_available SEC(".maps");
+
+// Number of valid slots in cpus_available
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u32);
+} cpus_count SEC(".maps");
+
+// Per-CPU counters of the steering program (RX CPU side)
+struct steer_stats {
+    __u64 redirected; // queued to a remote CPU
+    __u64 passed;     // non-IP or no CPUs configured, handled locally
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct steer_stats);
+} steer_stats SEC(".maps");
+
+// Per-CPU packet counter of the second-stage program (remote CPU side)
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+} remote_stats SEC(".maps");
+
+// Final mix of murmur3, spreads close addresses/ports over all slots
+static __always_inline __u32 mix32(__u32 h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// Symmetric IPv4 hash: both directions of a connection land on the same CPU,
+// so conntrack/socket state stays local to one core
+static __always_inline int hash_ipv4(struct iphdr *ip, void *data_end, __u32 *hash)
+{
+    if ((void *)(ip + 1) > data_end)
+        return -1;
+    if (ip->version != 4 || ip->ihl < 5)
+        return -1;
+
+    // Fragments hash on addresses and protocol only: non-first fragments have
+    // payload where the ports would be, and all fragments of a datagram must
+    // reach the same CPU for reassembly
+    __u32 ports = 0;
+    void *l4 = (void *)ip + ip->ihl * 4;
+    if (!(ip->frag_off & bpf_htons(IP_MF | IP_OFFSET))) {
+        if (ip->protocol == IPPROTO_TCP) {
+            struct tcphdr *tcp = l4;
+            if ((void *)(tcp + 1) <= data_end)
+                ports = tcp->source ^ tcp->dest;
+        } else if (ip->protocol == IPPROTO_UDP) {
+            struct udphdr *udp = l4;
+            if ((void *)(udp + 1) <= data_end)
+                ports = udp->source ^ udp->dest;
+        }
+    }
+
+    *hash = mix32((ip->saddr ^ ip->daddr) + (ports << 16 | ports) + ip->protocol);
+    return 0;
+}
+
+// Symmetric IPv6 hash: both 128-bit addresses are XOR-folded into 32 bits.
+// Ports are used only when TCP/UDP directly follows the fixed header; any
+// extension header (fragment header included) stops parsing, so fragments
+// of one datagram hash on addresses and next header only.
+static __always_inline int hash_ipv6(struct ipv6hdr *ip6, void *data_end, __u32 *hash)
+{
+    if ((void *)(ip6 + 1) > data_end)
+        return -1;
+    if (ip6->version != 6)
+        return -1;
+
+    __u32 addr = 0;
+#pragma unroll
+    for (int i = 0; i < 4; i++)
+        addr ^= ip6->saddr.in6_u.u6_addr32[i] ^ ip6->daddr.in6_u.u6_addr32[i];
+
+    __u32 ports = 0;
+    void *l4 = ip6 + 1;
+    if (ip6->nexthdr == IPPROTO_TCP) {
+        struct tcphdr *tcp = l4;
+        if ((void *)(tcp + 1) <= data_end)
+            ports = tcp->source ^ tcp->dest;
+    } else if (ip6->nexthdr == IPPROTO_UDP) {
+        struct udphdr *udp = l4;
+        if ((void *)(udp + 1) <= data_end)
+            ports = udp->source ^ udp->dest;
+    }
+
+    *hash = mix32(addr + (ports << 16 | ports) + ip6->nexthdr);
+    return 0;
+}
+
+// Flow hash for IPv4/IPv6, -1 for anything else (handled on the RX CPU)
+static __always_inline int flow_hash(struct xdp_md *ctx, __u32 *hash)
+{
+    void *data = (void *)(long)ctx->data;
+    void *data_end = (void *)(long)ctx->data_end;
+
+    struct ethhdr *eth = data;
+    if ((void *)(eth + 1) > data_end)
+        return -1;
+
+    if (eth->h_proto == bpf_htons(ETH_P_IP))
+        return hash_ipv4((void *)(eth + 1), data_end, hash);
+    if (eth->h_proto == bpf_htons(ETH_P_IPV6))
+        return hash_ipv6((void *)(eth + 1), data_end, hash);
+    return -1;
+}
+
+// First stage: runs on the CPU that received the packet from the NIC and
+// only picks a target CPU; all SKB work happens on the remote CPU
+SEC("xdp")
+int xdp_cpumap_steer(struct xdp_md *ctx)
+{
+    __u32 key = 0;
+    struct steer_stats *stats = bpf_map_lookup_elem(&steer_stats, &key);
+    if (!stats)
+        return XDP_PASS;
+
+    __u32 *count = bpf_map_lookup_elem(&cpus_count, &key);
+    __u32 hash = 0;
+    if (!count || *count == 0 || *count > MAX_SLOTS || flow_hash(ctx, &hash)) {
+        stats->passed++;
+        return XDP_PASS;
+    }
+
+    __u32 slot = hash % *count;
+    __u32 *cpu = bpf_map_lookup_elem(&cpus_available, &slot);
+    if (!cpu) {
+        stats->passed++;
+        return XDP_PASS;
+    }
+
+    // Lower bits of flags = action if cpu_map[*cpu] is empty (kernel 5.6+)
+    int action = bpf_redirect_map(&cpu_map, *cpu, XDP_PASS);
+    if (action == XDP_REDIRECT)
+        stats->redirected++;
+    else
+        stats->passed++;
+    return action;
+}
+
+// Optional second stage: attached to cpu_map entries by the loader and run
+// on the remote CPU right before the SKB is built. Only counts packets here,
+// which shows how evenly the flows are spread.
+SEC("xdp/cpumap")
+int xdp_cpumap_remote(struct xdp_md *ctx)
+{
+    __u32 key = 0;
+    __u64 *packets = bpf_map_lookup_elem(&remote_stats, &key);
+    if (packets)
+        (*packets)++;
+    return XDP_PASS;
+}
@@ -2,6 +2,29 @@
 #include <linux/if_ether.h> // Ethernet protocol definitions
 #include <bpf/bpf_helpers.h> // eBPF helper functions
 
+// Layout of the XDP metadata area written in front of every redirected packet.
+// Must match struct xdp_rx_meta in uspace/main.cpp - userspace reads it at
+// (packet address - sizeof(struct xdp_rx_meta)) inside the UMEM frame.
+#define XDP_RX_META_MAGIC  0x58445054 // "XDPT"
+#define XDP_RX_META_SW_TS  (1U << 0)  // sw_ts holds bpf_ktime_get_ns()
+#define XDP_RX_META_HW_TS  (1U << 1)  // hw_ts holds the NIC RX timestamp
+
+struct xdp_rx_meta {
+    __u64 hw_ts;  // NIC hardware RX timestamp (PHC clock domain), 0 if absent
+    __u64 sw_ts;  // CLOCK_MONOTONIC time when XDP program saw the packet
+    __u32 flags;  // XDP_RX_META_* bits describing valid fields
+    __u32 magic;  // XDP_RX_META_MAGIC, lets userspace detect missing metadata
+};
+
+#ifdef HW_TS
+// XDP metadata kfunc (kernel 6.3+), built only with HW_TS=1. The verifier
+// rejects any program calling it unless it is loaded device-bound
+// (bpftool prog load ... xdpmeta_dev <ifname>), and device-bound programs
+// can't be attached in generic (SKB) mode, so the default build skips it.
+extern int bpf_xdp_metadata_rx_timestamp(const struct xdp_md *ctx,
+                                         __u64 *timestamp) __ksym __weak;
+#endif
+
 // License declaration - mandatory for eBPF programs
 // Kernel verifier checks this to ensure GPL compatibility
 char LICENSE[] SEC("license") = "GPL";
@@ -26,6 +49,39 @@ struct {
     __uint(value_size, sizeof(__u32));
 } xsks_map SEC(".maps");  // Place in special ".maps" ELF section
 
+// Reserve space in front of the packet and store RX timestamps there.
+// Failures are not fatal: the packet is still redirected, userspace just
+// won't find the magic value and skips it in the latency histogram.
+static __always_inline void stamp_rx_meta(struct xdp_md *ctx)
+{
+    // Grow metadata area (negative delta moves data_meta towards headroom)
+    if (bpf_xdp_adjust_meta(ctx, -(int)sizeof(struct xdp_rx_meta)))
+        return;
+
+    // Pointers must be re-read after bpf_xdp_adjust_meta()
+    void *data = (void *)(long)ctx->data;
+    struct xdp_rx_meta *meta = (void *)(long)ctx->data_meta;
+
+    // Verifier requires explicit bounds check against data
+    if ((void *)(meta + 1) > data)
+        return;
+
+    meta->sw_ts = bpf_ktime_get_ns();
+    meta->hw_ts = 0;
+    meta->flags = XDP_RX_META_SW_TS;
+    meta->magic = XDP_RX_META_MAGIC;
+
+#ifdef HW_TS
+    // kfunc output must point to stack memory, not into the packet
+    __u64 hw_ts = 0;
+    if (bpf_ksym_exists(bpf_xdp_metadata_rx_timestamp) &&
+        bpf_xdp_metadata_rx_timestamp(ctx, &hw_ts) == 0) {
+        meta->hw_ts = hw_ts;
+        meta->flags |= XDP_RX_META_HW_TS;
+    }
+#endif
+}
+
 // XDP (eXpress Data Path) program section
 // This function is called for every packet received on the interface
 SEC("xdp")
@@ -40,6 +96,9 @@ int xdp_redirect_all(struct xdp_md *ctx)
     if (index >= 64)
         return XDP_PASS;  // Let packet continue through normal network stack
     
+    // Stamp arrival time as early as possible, before the redirect
+    stamp_rx_meta(ctx);
+    
     // Debug output - writes to kernel trace buffer
     // Can be viewed with: sudo cat /sys/kernel/debug/tracing/trace_pipe
     // Note: In production, remove or conditionalize this for performance
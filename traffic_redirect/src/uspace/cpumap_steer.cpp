@@ -0,0 +1,270 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <csignal>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <net/if.h>
+#include <linux/if_link.h>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#include "xdp_profile.h"
+
+/* ---------- КОНФИГУРАЦИЯ ---------- */
+static constexpr __u32 DEFAULT_QSIZE = 2048;  // Размер очереди cpumap на каждый CPU
+static constexpr __u32 MAX_SLOTS     = 64;    // Емкость cpus_available, как в kspace/cpumap_steer.c
+
+// Счетчики первой стадии (должны совпадать с eBPF-программой)
+struct steer_stats {
+    __u64 redirected;
+    __u64 passed;
+};
+
+static std::atomic<bool> running{true};
+
+// Обработчик сигналов (Ctrl+C)
+static void signal_handler(int) {
+    running = false;
+}
+
+// Разбор списка CPU вида "1,2,4-7"
+static bool parse_cpu_list(const char *str, std::vector<__u32> &cpus) {
+    const char *p = str;
+    while (*p) {
+        char *end = nullptr;
+        unsigned long first = strtoul(p, &end, 10);
+        if (end == p)
+            return false;
+        unsigned long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+            cpus.push_back((__u32)cpu);
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return false;
+        p = end;
+    }
+    return !cpus.empty();
+}
+
+// Онлайн CPU из /sys/devices/system/cpu/online ("0-3,5\n")
+static bool read_online_cpus(std::vector<__u32> &cpus) {
+    FILE *f = fopen("/sys/devices/system/cpu/online", "r");
+    if (!f)
+        return false;
+    char buf[256] = {};
+    bool ok = fgets(buf, sizeof(buf), f) != nullptr;
+    fclose(f);
+    if (!ok)
+        return false;
+    buf[strcspn(buf, "\n")] = '\0';
+    return parse_cpu_list(buf, cpus);
+}
+
+// Выводит распределение пакетов за последний интервал
+static void print_stats(int steer_fd, int remote_fd, int ncpus,
+                        steer_stats &prev_steer, std::vector<__u64> &prev_remote) {
+    __u32 key = 0;
+    std::vector<steer_stats> steer(ncpus);
+    if (bpf_map_lookup_elem(steer_fd, &key, steer.data()) == 0) {
+        steer_stats total = {};
+        for (const auto &s : steer) {
+            total.redirected += s.redirected;
+            total.passed += s.passed;
+        }
+        printf("steer: redirected=%llu passed=%llu\n",
+               (unsigned long long)(total.redirected - prev_steer.redirected),
+               (unsigned long long)(total.passed - prev_steer.passed));
+        prev_steer = total;
+    }
+
+    if (remote_fd < 0)
+        return;
+
+    std::vector<__u64> remote(ncpus);
+    if (bpf_map_lookup_elem(remote_fd, &key, remote.data()) != 0)
+        return;
+    printf("remote:");
+    for (int cpu = 0; cpu < ncpus; cpu++) {
+        __u64 delta = remote[cpu] - prev_remote[cpu];
+        if (delta)
+            printf(" cpu%d=%llu", cpu, (unsigned long long)delta);
+    }
+    printf("\n");
+    prev_remote = remote;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        printf("Usage: %s <ifname> <xdp-obj-path> <cpu-list> [qsize] [chain]\n", argv[0]);
+        printf("  cpu-list - target CPUs, e.g. 1,2,4-7\n");
+        printf("  qsize    - per-CPU cpumap queue size (default %u)\n", DEFAULT_QSIZE);
+        printf("  chain    - run xdp_cpumap_remote on the remote CPU\n");
+        return 1;
+    }
+
+    const char *ifname = argv[1];
+    const char *xdp_obj_path = argv[2];
+    __u32 qsize = argc > 4 ? (__u32)strtoul(argv[4], nullptr, 10) : DEFAULT_QSIZE;
+    bool chain = argc > 5 && strcmp(argv[5], "chain") == 0;
+    unsigned int flags = XDP_FLAGS_UPDATE_IF_NOEXIST;
+    struct bpf_object *obj = nullptr;
+    struct bpf_map *cpu_map = nullptr;
+    int ifindex, prog_fd, remote_prog_fd, cpu_map_fd, avail_fd, count_fd, steer_fd;
+    int remote_stats_fd = -1;
+    int ret = 1;
+    int ncpus = libbpf_num_possible_cpus();
+    __u32 key = 0, count = 0;
+    std::vector<__u32> cpus, online;
+    std::vector<__u64> prev_remote;
+    steer_stats prev_steer = {};
+    XdpProfiler profiler;
+
+    // 1. Настройка обработчика сигналов
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    // 2. Проверяем параметры
+    if (!parse_cpu_list(argv[3], cpus)) {
+        fprintf(stderr, "Invalid cpu list '%s'\n", argv[3]);
+        return 1;
+    }
+    if (cpus.size() > MAX_SLOTS) {
+        fprintf(stderr, "Too many target CPUs (%zu, max %u)\n", cpus.size(), MAX_SLOTS);
+        return 1;
+    }
+    if (ncpus <= 0) {
+        fprintf(stderr, "Failed to get number of CPUs\n");
+        return 1;
+    }
+    // kthread очереди на offline CPU не запускается - пакеты молча теряются
+    if (!read_online_cpus(online)) {
+        fprintf(stderr, "Failed to read /sys/devices/system/cpu/online\n");
+        return 1;
+    }
+    for (__u32 cpu : cpus) {
+        if (cpu >= (__u32)ncpus) {
+            fprintf(stderr, "CPU %u is out of range (possible CPUs: %d)\n", cpu, ncpus);
+            return 1;
+        }
+        if (std::find(online.begin(), online.end(), cpu) == online.end()) {
+            fprintf(stderr, "CPU %u is offline\n", cpu);
+            return 1;
+        }
+    }
+    if (qsize == 0) {
+        fprintf(stderr, "Invalid queue size\n");
+        return 1;
+    }
+    prev_remote.assign(ncpus, 0);
+
+    // 3. Получаем индекс интерфейса
+    ifindex = if_nametoindex(ifname);
+    if (!ifindex) {
+        perror("if_nametoindex");
+        return 1;
+    }
+
+    // 4. Открываем объект BPF, ключ cpu_map - номер CPU, размер по числу CPU
+    obj = bpf_object__open(xdp_obj_path);
+    if (libbpf_get_error(obj)) {
+        fprintf(stderr, "Failed to open BPF object\n");
+        return 1;
+    }
+
+    cpu_map = bpf_object__find_map_by_name(obj, "cpu_map");
+    if (!cpu_map || bpf_map__set_max_entries(cpu_map, ncpus)) {
+        fprintf(stderr, "Failed to resize cpu_map\n");
+        goto cleanup;
+    }
+
+    // 5. Загружаем программы в ядро
+    if (bpf_object__load(obj)) {
+        fprintf(stderr, "Failed to load BPF object\n");
+        goto cleanup;
+    }
+
+    prog_fd = bpf_program__fd(bpf_object__find_program_by_name(obj, "xdp_cpumap_steer"));
+    remote_prog_fd = bpf_program__fd(bpf_object__find_program_by_name(obj, "xdp_cpumap_remote"));
+    if (prog_fd < 0 || (chain && remote_prog_fd < 0)) {
+        fprintf(stderr, "Failed to find XDP program\n");
+        goto cleanup;
+    }
+
+    cpu_map_fd = bpf_map__fd(cpu_map);
+    avail_fd = bpf_object__find_map_fd_by_name(obj, "cpus_available");
+    count_fd = bpf_object__find_map_fd_by_name(obj, "cpus_count");
+    steer_fd = bpf_object__find_map_fd_by_name(obj, "steer_stats");
+    if (chain)
+        remote_stats_fd = bpf_object__find_map_fd_by_name(obj, "remote_stats");
+    if (avail_fd < 0 || count_fd < 0 || steer_fd < 0 || (chain && remote_stats_fd < 0)) {
+        fprintf(stderr, "Failed to find cpumap maps\n");
+        goto cleanup;
+    }
+
+    // 6. Создаем очереди на целевых CPU (ядро запускает kthread на каждый CPU)
+    for (__u32 slot = 0; slot < cpus.size(); slot++) {
+        struct bpf_cpumap_val val;
+        memset(&val, 0, sizeof(val));
+        val.qsize = qsize;
+        val.bpf_prog.fd = chain ? remote_prog_fd : 0;
+
+        if (bpf_map_update_elem(cpu_map_fd, &cpus[slot], &val, BPF_ANY)) {
+            perror("Failed to add CPU to cpu_map");
+            goto cleanup;
+        }
+        if (bpf_map_update_elem(avail_fd, &slot, &cpus[slot], BPF_ANY)) {
+            perror("Failed to update cpus_available");
+            goto cleanup;
+        }
+    }
+
+    count = cpus.size();
+    if (bpf_map_update_elem(count_fd, &key, &count, BPF_ANY)) {
+        perror("Failed to update cpus_count");
+        goto cleanup;
+    }
+
+    // 7. Прикрепляем XDP-программу
+    if (bpf_set_link_xdp_fd(ifindex, prog_fd, flags) < 0) {
+        fprintf(stderr, "Failed to attach XDP program\n");
+        goto cleanup;
+    }
+
+    // Распределение пакетов выводится раз в секунду в общем отчете
+    profiler.add_section([&]() {
+        print_stats(steer_fd, remote_stats_fd, ncpus, prev_steer, prev_remote);
+    });
+
+    // Профилирование (XDP_PROFILE=1): время обеих стадий
+    if (profiler.start()) {
+        profiler.add_program("xdp_cpumap_steer", prog_fd);
+        if (chain)
+            profiler.add_program("xdp_cpumap_remote", remote_prog_fd);
+    }
+
+    printf("Steering %s across %u CPUs (qsize=%u%s). Press Ctrl+C to stop.\n",
+           ifname, count, qsize, chain ? ", chained" : "");
+
+    // 8. Отчеты выводит таймер профилировщика
+    while (running) {
+        usleep(100000); // 100ms
+        profiler.maybe_report();
+    }
+
+    // 9. Очистка
+    ret = 0;
+    bpf_set_link_xdp_fd(ifindex, -1, flags);
+cleanup:
+    bpf_object__close(obj);
+    return ret;
+}
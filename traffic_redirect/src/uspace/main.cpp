@@ -1,18 +1,115 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <unistd.h>
 #include <bpf/bpf.h>
 #include <xdp/xsk.h>
 #include <net/if.h>
 #include <linux/if_link.h>
 
+#include "xdp_profile.h"
+
 /* ---------- КОНФИГУРАЦИЯ ---------- */
 static constexpr size_t FRAME_SZ = 4096;      // Размер одного буфера
 static constexpr size_t RING_SZ  = 4096;      // Количество буферов в кольце
 static constexpr int    QUEUE_ID = 0;         // RX очередь (для lo всегда 0)
 static constexpr char   IFNAME[] = "lo";      // Интерфейс
 
+/* ---------- МЕТАДАННЫЕ XDP ---------- */
+// Должно совпадать с struct xdp_rx_meta в kspace/redirect_all.c.
+// eBPF программа кладет эту структуру прямо перед пакетом через bpf_xdp_adjust_meta.
+static constexpr uint32_t XDP_RX_META_MAGIC = 0x58445054; // "XDPT"
+static constexpr uint32_t XDP_RX_META_SW_TS = 1U << 0;
+static constexpr uint32_t XDP_RX_META_HW_TS = 1U << 1;
+
+struct xdp_rx_meta {
+    uint64_t hw_ts;  // HW timestamp сетевой карты (часы PHC)
+    uint64_t sw_ts;  // bpf_ktime_get_ns() == CLOCK_MONOTONIC
+    uint32_t flags;
+    uint32_t magic;
+};
+
+// Headroom во фрейме UMEM под метаданные, чтобы они не вылезали за начало фрейма
+static constexpr uint32_t FRAME_HEADROOM = sizeof(xdp_rx_meta);
+
+/* ---------- ГИСТОГРАММА ЗАДЕРЖЕК ---------- */
+// Лог-линейная гистограмма в стиле HdrHistogram: каждая степень двойки
+// делится на 2^SUB_BITS поддиапазонов, относительная погрешность ~3%.
+// Память постоянная, запись - O(1) без аллокаций.
+class LatencyHistogram {
+public:
+    void record(uint64_t value) {
+        counts_[bucket_of(value)]++;
+        total_++;
+        if (value > max_) max_ = value;
+    }
+
+    // Верхняя граница корзины, в которую попал q-квантиль (q в [0, 1]).
+    // Ранг round(q * n) (q * n + 0.5 с отбрасыванием дробной части), как в
+    // HdrHistogram: p99.9 из 1000 значений - 999-е, а не максимум
+    uint64_t percentile(double q) const {
+        if (total_ == 0) return 0;
+        uint64_t target = (uint64_t)(q * (double)total_ + 0.5);
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKETS; i++) {
+            seen += counts_[i];
+            if (seen >= target)
+                return bucket_upper(i) < max_ ? bucket_upper(i) : max_;
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+
+    void reset() {
+        memset(counts_, 0, sizeof(counts_));
+        total_ = 0;
+        max_ = 0;
+    }
+
+private:
+    static constexpr uint32_t SUB_BITS = 5;
+    static constexpr uint32_t SUB_COUNT = 1U << SUB_BITS;
+    static constexpr uint32_t BUCKETS = 64 * SUB_COUNT;
+
+    static uint32_t bucket_of(uint64_t v) {
+        if (v < SUB_COUNT) return (uint32_t)v;
+        uint32_t msb = 63 - __builtin_clzll(v);
+        uint32_t shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + (uint32_t)((v >> shift) - SUB_COUNT);
+    }
+
+    static uint64_t bucket_upper(uint32_t idx) {
+        if (idx < SUB_COUNT) return idx;
+        uint32_t shift = idx / SUB_COUNT - 1;
+        uint64_t top = idx % SUB_COUNT + SUB_COUNT;
+        return ((top + 1) << shift) - 1;
+    }
+
+    uint64_t counts_[BUCKETS] = {};
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+};
+
+static uint64_t now_ns(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void report_histogram(const char *name, const LatencyHistogram &h) {
+    printf("[LATENCY] %-10s n=%llu p50=%llu p99=%llu p99.9=%llu max=%llu ns\n",
+           name,
+           (unsigned long long)h.count(),
+           (unsigned long long)h.percentile(0.50),
+           (unsigned long long)h.percentile(0.99),
+           (unsigned long long)h.percentile(0.999),
+           (unsigned long long)h.max());
+}
+
 /* ---------- ОСНОВНАЯ ФУНКЦИЯ ---------- */
 int main() {
     // Объявляем ВСЕ переменные в начале функции
@@ -28,6 +125,13 @@ int main() {
     uint32_t idx = 0;
     int packet_count = 0;
     
+    // XDP -> userspace (bpf_ktime_get_ns vs CLOCK_MONOTONIC)
+    LatencyHistogram sw_latency;
+    // NIC -> userspace, имеет смысл только если PHC синхронизирован с
+    // системным временем (ptp4l + phc2sys) и программа загружена с HW_TS=1
+    LatencyHistogram hw_latency;
+    uint64_t no_meta_count = 0;
+    
     printf("=== AF_XDP Packet Receiver ===\n");
     printf("Interface: %s, Queue: %d\n\n", IFNAME, QUEUE_ID);
     
@@ -45,7 +149,7 @@ int main() {
         .fill_size = RING_SZ,
         .comp_size = RING_SZ,
         .frame_size = FRAME_SZ,
-        .frame_headroom = 0,
+        .frame_headroom = FRAME_HEADROOM,
         .flags = 0
     };
     
@@ -107,6 +211,30 @@ int main() {
     }
     xsk_ring_prod__submit(&fq, n);
     printf("[5] Fill Queue filled with %u buffers\n", n);
+    
+    /* Профилирование (XDP_PROFILE=1): программа загружена через bpftool и закреплена */
+    XdpProfiler profiler;
+    
+    /* Гистограммы задержек выводятся раз в секунду в общем отчете */
+    profiler.add_section([&]() {
+        report_histogram("xdp->user", sw_latency);
+        if (hw_latency.count() > 0)
+            report_histogram("nic->user", hw_latency);
+        if (no_meta_count > 0)
+            printf("[LATENCY] %llu packets without XDP metadata\n",
+                   (unsigned long long)no_meta_count);
+        sw_latency.reset();
+        hw_latency.reset();
+        no_meta_count = 0;
+    });
+    
+    if (profiler.start()) {
+        int prog_fd = bpf_obj_get("/sys/fs/bpf/xdp_redirect");
+        if (prog_fd < 0)
+            perror("bpf_obj_get(/sys/fs/bpf/xdp_redirect)");
+        profiler.add_program("xdp_redirect_all", prog_fd);
+        profiler.set_xsk_fd(xsk_socket__fd(xsk));
+    }
     printf("\n[READY] Waiting for packets (send ping to %s)...\n", IFNAME);
     
     /* 6. ОСНОВНОЙ ЦИКЛ ПРИЕМА ПАКЕТОВ */
@@ -114,14 +242,38 @@ int main() {
         uint32_t rx_idx = 0, fq_idx = 0;
         
         /* 6.1 Проверяем, есть ли пакеты в RX Queue */
+        uint64_t batch_start = xdp_profile_cycles();
         uint32_t rx_packets = xsk_ring_cons__peek(&rxq, 64, &rx_idx);
         
         if (rx_packets > 0) {
+            /* Момент, когда пачка пакетов дошла до userspace */
+            uint64_t batch_mono = now_ns(CLOCK_MONOTONIC);
+            uint64_t batch_tai = now_ns(CLOCK_TAI);
+            
             /* 6.2 Обрабатываем каждый полученный пакет */
             for (uint32_t i = 0; i < rx_packets; i++) {
                 uint64_t addr = xsk_ring_cons__rx_desc(&rxq, rx_idx + i)->addr;
                 uint32_t len = xsk_ring_cons__rx_desc(&rxq, rx_idx + i)->len;
                 
+                /* Метаданные лежат непосредственно перед пакетом */
+                struct xdp_rx_meta meta;
+                uint8_t *meta_ptr = (uint8_t*)umem_area + addr - sizeof(meta);
+                memcpy(&meta, meta_ptr, sizeof(meta));
+                
+                /* Фреймы UMEM переиспользуются: стираем magic до возврата фрейма
+                   в Fill Queue, иначе пакет без метаданных (adjust_meta не сработал)
+                   покажет старые метки времени предыдущего пакета */
+                const uint32_t no_magic = 0;
+                memcpy(meta_ptr + offsetof(struct xdp_rx_meta, magic), &no_magic, sizeof(no_magic));
+                if (meta.magic == XDP_RX_META_MAGIC) {
+                    if ((meta.flags & XDP_RX_META_SW_TS) && batch_mono >= meta.sw_ts)
+                        sw_latency.record(batch_mono - meta.sw_ts);
+                    if ((meta.flags & XDP_RX_META_HW_TS) && batch_tai >= meta.hw_ts)
+                        hw_latency.record(batch_tai - meta.hw_ts);
+                } else {
+                    no_meta_count++;
+                }
+                
                 packet_count++;
                 printf("[PACKET #%d] %u bytes | Addr: 0x%lx\n", 
                        packet_count, len, (unsigned long)addr);
@@ -147,11 +299,16 @@ int main() {
                     xsk_ring_cons__rx_desc(&rxq, rx_idx + i)->addr;
             }
             xsk_ring_prod__submit(&fq, filled);
+            profiler.record_batch(rx_packets, xdp_profile_cycles() - batch_start);
             
         } else {
             /* 6.5 Нет пакетов - небольшая пауза */
+            profiler.record_batch(0, 0);
             usleep(1000); // 1ms
         }
+        
+        /* 6.6 Периодический отчет: гистограммы задержек и профилирование */
+        profiler.maybe_report();
     }
     return 0; 
 // cleanup: